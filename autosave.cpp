@@ -0,0 +1,246 @@
+#include <Arduino.h>
+#include <Adafruit_GFX.h>    // Core graphics library
+#include <Adafruit_ST7735.h> // Hardware-specific library
+#include <SPI.h>
+#include <SD.h>
+#include "functions.h"
+
+/**
+   Saving the drawing to the SD card and restoring it at startup
+
+   - the SD card is brought up from loop() once the joystick and size
+   dial have been left alone for SD_IDLE_MS: without a card, starting
+   it blocks for about 2 s, which should not land on the first strokes
+   - the drawing is saved to AUTOSAVE_FILE every AUTOSAVE_MS while it
+   has changed, once the joystick has also been left alone for
+   SD_IDLE_MS, as a raw dump of all_pixels.bytes (the format read by
+   host/batch_render)
+   - each save is first written in full to AUTOSAVE_TEMP, which is only
+   removed once AUTOSAVE_FILE has been rewritten, so losing power part
+   way through a save always leaves one complete copy on the card
+   - at startup, a saved drawing is restored RESTORE_BAND rows per
+   loop(), so the user can draw while it fills in; pixels drawn or
+   erased before their band is restored are kept, colours swapped or
+   erased across the drawing in the meantime are changed in the bands
+   still to come, and once the canvas has been cleared nothing is
+   restored, even if the card starts afterwards
+*/
+
+const char AUTOSAVE_FILE[] = "CANVAS.RAW";
+const char AUTOSAVE_TEMP[] = "CANVAS.TMP";
+const unsigned long AUTOSAVE_MS = 30000;
+const int RESTORE_BAND = 8; // rows restored per loop()
+const unsigned long SD_IDLE_MS = 1000; // idle time before starting the card
+
+// state of the SD card: 0 = not started, 1 = ready, -1 = unavailable
+int sd_state = 0;
+int restore_row = PixelCanvas::HEIGHT; // next row to restore
+// cleared once the saved drawing has been restored, is not wanted or
+// cannot be read
+int restore_pending = 1;
+File restore_file;
+// colour bits each saved pixel is restored as, after the remaps of the
+// drawing made while the restore was pending
+uint8_t restore_map[4] = {0, 1, 2, 3};
+int restore_remapped = 0; // set once restore_map is not the identity
+unsigned long last_save = 0;
+int canvas_changed = 0; // set when the drawing changes after a save
+
+/**
+   uint8_ts of all_pixels that the eraser went over while a restore was
+   pending; an erased pixel is white like one that was never drawn, so
+   the restore keeps these uint8_ts as they are
+
+   - bit (j % 8) of erased_bytes[i][j/8] is set for all_pixels.bytes[i][j]
+   - 32 columns * 17 uint8_ts of 8 rows = 544 bytes
+*/
+uint8_t erased_bytes[PixelCanvas::COLUMNS][(PixelCanvas::HEIGHT + 7)/8];
+
+// FUNCTION: opens a saved drawing
+// RETURNS: the open file, or a closed one if it is missing or was not
+// completely written
+// RUNTIME: O(1)
+static File open_save(const char* name) {
+  File file = SD.open(name);
+  if (file && file.size() != PixelCanvas::BYTES) {
+    file.close();
+  }
+  return file;
+}
+
+// FUNCTION: brings up the SD card at full speed and, if there is a
+// saved drawing, starts restoring it
+// RUNTIME: O(1)
+void start_sd() {
+  Serial.print("Initializing SD card...");
+  if (!SD.begin(SD_CS) || !card.init(SPI_FULL_SPEED, SD_CS)) {
+    Serial.println("failed! Autosave is off.");
+    sd_state = -1;
+    restore_pending = 0;
+    return;
+  }
+  Serial.println("OK!");
+  sd_state = 1;
+  last_save = millis();
+  if (!restore_pending) {
+    return;
+  }
+
+  // a complete AUTOSAVE_TEMP means the last save stopped before
+  // AUTOSAVE_FILE was rewritten, so it holds the newer drawing;
+  // saving again soon brings AUTOSAVE_FILE up to date
+  restore_file = open_save(AUTOSAVE_TEMP);
+  if (restore_file) {
+    canvas_changed = 1;
+  } else {
+    restore_file = open_save(AUTOSAVE_FILE);
+  }
+  if (restore_file) {
+    restore_row = 0;
+  } else {
+    restore_pending = 0;
+  }
+}
+
+// FUNCTION: stops restoring the saved drawing, or keeps it from
+// being restored once the SD card starts, e.g. when the canvas is
+// cleared
+// RUNTIME: O(1)
+void cancel_restore() {
+  restore_pending = 0;
+  if (restore_row < PixelCanvas::HEIGHT) {
+    restore_file.close();
+    restore_row = PixelCanvas::HEIGHT;
+  }
+}
+
+// FUNCTION: notes that the eraser went over columns x0 to x1 - 1 of
+// rows y0 to y1 - 1 before they were restored
+// RUNTIME: O(n^2) - every row AND uint8_t of the region
+void mark_erased(int x0, int y0, int x1, int y1) {
+  x1 = min(x1, (int) PixelCanvas::WIDTH);
+  y1 = min(y1, (int) PixelCanvas::HEIGHT);
+  for (int i = x0 / PixelCanvas::PIXELS_PER_BYTE;
+       i * PixelCanvas::PIXELS_PER_BYTE < x1; ++i) {
+    for (int j = y0; j < y1; ++j) {
+      erased_bytes[i][j/8] |= 1 << (j % 8);
+    }
+  }
+}
+
+// FUNCTION: notes that colour bits i in the drawing were changed to
+// map[i], so that the rows still to be restored are changed too
+// RUNTIME: O(1)
+void remap_restore(const uint8_t map[4]) {
+  for (int i = 0; i < 4; ++i) {
+    restore_map[i] = map[restore_map[i]];
+    restore_remapped |= restore_map[i] != i;
+  }
+}
+
+// FUNCTION: restores the next band of rows from the saved drawing
+// and repaints them
+// RUNTIME: O(n) - every column of RESTORE_BAND rows
+void restore_band() {
+  int y0 = restore_row;
+  int rows = min(RESTORE_BAND, PixelCanvas::HEIGHT - y0);
+  uint8_t saved[RESTORE_BAND];
+
+  // the dump is stored column by column, so each column of the
+  // band is a separate run of bytes
+  for (int i = 0; i < PixelCanvas::COLUMNS; ++i) {
+    restore_file.seek((unsigned long) i * PixelCanvas::HEIGHT + y0);
+    if (restore_file.read(saved, rows) != rows) {
+      Serial.println("Restore failed");
+      cancel_restore();
+      return;
+    }
+    for (int j = y0; j < y0 + rows; ++j) {
+      uint8_t packed = saved[j - y0];
+      if (restore_remapped) {
+	for (int x = 0; x < PixelCanvas::PIXELS_PER_BYTE; ++x) {
+	  uint8_t bits = PixelCanvas::unpack(packed, x);
+	  if (bits < 4) {
+	    packed ^= (bits ^ restore_map[bits]) << PixelCanvas::shift(x);
+	  }
+	}
+      }
+      // keep whatever was drawn or erased since startup, fill in the rest
+      uint8_t& live = all_pixels.bytes[i][j];
+      uint8_t kept = PixelCanvas::drawn_mask(live);
+      if (erased_bytes[i][j/8] & (1 << (j % 8))) {
+	kept = 0xFF;
+      }
+      live = (live & kept) | (packed & ~kept);
+    }
+  }
+  for (int j = y0; j < y0 + rows; ++j) {
+    changed_rows[j/8] |= 1 << (j % 8);
+  }
+  repaint_changed_rows();
+
+  // the repaint covers the cursor if it is in the band
+  if (digitalRead(JOYSTICK_BUTTON) == HIGH &&
+      cursor_y < y0 + rows && cursor_y + cursor_size + 1 > y0) {
+    cursor_border = 1;
+    draw_cursor(cursor_x, cursor_y, cursor_size, current_shape,
+		current_colour);
+  }
+
+  restore_row += rows;
+  if (restore_row >= PixelCanvas::HEIGHT) {
+    restore_file.close();
+    restore_pending = 0;
+    Serial.print("Canvas restored after ");
+    Serial.print(millis());
+    Serial.println(" ms");
+  }
+}
+
+// FUNCTION: replaces a file on the SD card with the drawing
+// RETURNS: 1 if the whole drawing was written, 0 otherwise
+// RUNTIME: O(n^2) - every row AND column of the drawing
+static int write_canvas(const char* name) {
+  SD.remove((char*) name); // opening for writing appends
+  File file = SD.open(name, FILE_WRITE);
+  if (!file) {
+    return 0;
+  }
+  size_t written = file.write(&all_pixels.bytes[0][0], PixelCanvas::BYTES);
+  file.close();
+  return written == PixelCanvas::BYTES;
+}
+
+// FUNCTION: writes the drawing to the SD card, keeping a complete
+// copy on the card at every step
+// RUNTIME: O(n^2) - every row AND column of the drawing
+void save_canvas() {
+  // AUTOSAVE_FILE is only touched once AUTOSAVE_TEMP is complete, and
+  // AUTOSAVE_TEMP is only removed once AUTOSAVE_FILE is complete
+  if (!write_canvas(AUTOSAVE_TEMP) || !write_canvas(AUTOSAVE_FILE)) {
+    Serial.println("Autosave failed");
+    return; // still changed, so the next autosave tries again
+  }
+  SD.remove((char*) AUTOSAVE_TEMP);
+  canvas_changed = 0;
+}
+
+// FUNCTION: does one step of the SD card work: starting the card once
+// the user is idle, restoring one band of the saved drawing, or
+// autosaving once the user is idle
+// RUNTIME: O(n^2) when saving, otherwise O(n)
+void storage_step() {
+  if (sd_state == 0) {
+    if (millis() - last_input >= SD_IDLE_MS) {
+      start_sd();
+    }
+  } else if (sd_state == 1 && restore_row < PixelCanvas::HEIGHT) {
+    restore_band();
+  } else if (sd_state == 1 && canvas_changed &&
+	     millis() - last_save >= AUTOSAVE_MS &&
+	     // saving stalls the cursor, so wait until it is not in use
+	     millis() - last_input >= SD_IDLE_MS) {
+    save_canvas();
+    last_save = millis();
+  }
+}
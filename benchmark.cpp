@@ -0,0 +1,403 @@
+#ifdef BENCHMARK
+
+#include <Arduino.h>
+#include <Adafruit_GFX.h>    // Core graphics library
+#include <Adafruit_ST7735.h> // Hardware-specific library
+#include <SPI.h>
+#include <SD.h>
+#include <EEPROM.h>
+#include "functions.h"
+
+#if CANVAS_BPP != 2
+#error "the benchmark oracle is recorded for the 2 bpp canvas"
+#endif
+
+/**
+   Timing of the packed-pixel kernels
+
+   - on the board: build with BENCHMARK defined (see Makefile) and open
+   the serial monitor at 9600 baud; results are printed as ns per pixel
+   - on the host: `make bench` in host/ builds this file with BENCH_HOST
+   defined against stub Arduino headers (host/stubs); each kernel is run
+   BENCH_REPEAT times per pass, and after a warm-up pass the best of
+   BENCH_PASSES passes is printed as ps per pixel, with the difference
+   between the median and the best pass as the spread
+   - every pass also times reference_save_pixel, which never changes;
+   a host running slower or faster than when the baseline was recorded
+   shows up as a change in that time, and the baseline is scaled by it
+   - the first run (or any run built with BENCHMARK_RECORD) stores the
+   results in EEPROM as the baseline; later runs flag any kernel that is
+   more than BENCH_TOLERANCE percent slower than the scaled baseline
+   - before timing anything, an oracle checks that save_pixel and
+   store_colour still produce byte-identical all_pixels contents to
+   the original implementation
+*/
+
+// number of results that are kept in the baseline
+// reference_save_pixel: 1, save_pixel: 4 alignments,
+// bits_to_colour (pixel): 4 colours, bits_to_colour (region): 3 sizes,
+// store_colour: 3 shapes * 3 sizes, initialize_colour_array: 1
+const int BENCH_RESULTS = 22;
+const uint16_t BENCH_MAGIC = 0x5043; // "PC", marks a stored baseline
+
+#ifdef BENCH_HOST
+const char BENCH_UNIT[] = "ps/px";
+const unsigned long BENCH_UNITS_PER_US = 1000000UL;
+const int BENCH_REPEAT = 100; // the host needs many runs to measure
+// the host is shared with other processes and can be slowed down for
+// seconds at a time, so the passes are spread over a few seconds; the
+// best pass is the closest to the kernel itself
+const int BENCH_WARMUP = 1;
+const int BENCH_PASSES = 60;
+// percent slower before flagging: over 30 runs, the scaled best times
+// stayed within 11% of their median, so two runs can differ by 22%
+const int BENCH_TOLERANCE = 25;
+#else
+const char BENCH_UNIT[] = "ns/px";
+const unsigned long BENCH_UNITS_PER_US = 1000UL;
+const int BENCH_REPEAT = 1;
+// nothing else runs on the board, so one pass gives the same time
+const int BENCH_WARMUP = 0;
+const int BENCH_PASSES = 1;
+const int BENCH_TOLERANCE = 10; // percent slower before flagging
+#endif
+
+const int BENCH_COLOURS[4] = {WHITE, BLACK, RED, BLUE};
+const int BENCH_SIZES[3] = {4, 8, 12};
+const char BENCH_SHAPES[3] = {'r', 'c', 's'};
+
+// checksum of the store_colour workload in oracle_store_colour(),
+// recorded from the original implementation of store_colour/save_pixel
+const uint32_t STORE_COLOUR_CHECKSUM = 0xBE00AC81UL;
+
+uint16_t bench_results[BENCH_RESULTS]; // best time of each kernel
+uint16_t bench_passes[BENCH_RESULTS][BENCH_PASSES]; // every pass
+int bench_index = 0;
+int bench_pass = 0; // negative during the warm-up
+int bench_failures = 0;
+
+// FUNCTION: original save_pixel, kept as the reference the oracle
+// compares the live kernel against
+// RUNTIME: O(1)
+void reference_save_pixel(uint8_t* block, int x, int colour) {
+  uint8_t bits = 0b11000000 >> 2*(x % 4);
+  uint8_t colour_bits = 0;
+
+  if (colour == BLACK) {
+    colour_bits = 0b01010101;
+  } else if (colour == RED) {
+    colour_bits = 0b10101010;
+  } else if (colour == BLUE) {
+    colour_bits = 0b11111111;
+  }
+  *block = (*block & ~bits) | (colour_bits & bits);
+}
+
+// FUNCTION: folds one byte into a running FNV-1a hash
+// RUNTIME: O(1)
+uint32_t hash_byte(uint32_t hash, uint8_t value) {
+  hash ^= value;
+  return hash * 16777619UL;
+}
+
+// FUNCTION: checks save_pixel against the reference for every
+// alignment, colour and starting byte value
+// RETURNS: number of mismatches
+// RUNTIME: O(n) - 4 alignments * 4 colours * 256 starting values
+int oracle_save_pixel() {
+  int mismatches = 0;
+
+  for (int x = 0; x < 4; ++x) {
+    for (int c = 0; c < 4; ++c) {
+      for (int start = 0; start < 256; ++start) {
+	uint8_t expected = start;
+	reference_save_pixel(&expected, x, BENCH_COLOURS[c]);
+
+	all_pixels.bytes[0][0] = start;
+	save_pixel(x, 0, BENCH_COLOURS[c]);
+	if (all_pixels.bytes[0][0] != expected) ++mismatches;
+      }
+    }
+  }
+  return mismatches;
+}
+
+// FUNCTION: stamps every shape, size, alignment and colour into a
+// blank canvas and hashes the bytes around each stamp
+// RETURNS: hash of the whole workload
+// RUNTIME: O(n) - 144 stamps, each followed by a clear
+uint32_t oracle_store_colour() {
+  uint32_t hash = 2166136261UL;
+  char saved_shape = current_shape;
+
+  for (int s = 0; s < 3; ++s) {
+    current_shape = BENCH_SHAPES[s];
+    for (int z = 0; z < 3; ++z) {
+      for (int x = 0; x < 4; ++x) {
+	for (int c = 0; c < 4; ++c) {
+	  // start from a black canvas so that white stamps are visible
+	  for (int i = 0; i < PixelCanvas::COLUMNS; ++i) {
+	    for (int j = 0; j < PixelCanvas::HEIGHT; ++j) {
+	      all_pixels.bytes[i][j] = 0b01010101;
+	    }
+	  }
+	  store_colour(40 + x, 60, BENCH_SIZES[z], BENCH_COLOURS[c]);
+
+	  // stamps reach at most 13 pixels right/down of the corner
+	  for (int i = 40/PixelCanvas::PIXELS_PER_BYTE;
+	       i <= (40 + 3 + 13)/PixelCanvas::PIXELS_PER_BYTE; ++i) {
+	    for (int j = 60; j <= 60 + 13; ++j) {
+	      hash = hash_byte(hash, all_pixels.bytes[i][j]);
+	    }
+	  }
+	}
+      }
+    }
+  }
+  current_shape = saved_shape;
+  return hash;
+}
+
+// FUNCTION: converts a measured time to time per pixel
+// RETURNS: BENCH_UNIT per pixel, saturated to fit the baseline table
+// RUNTIME: O(1)
+uint16_t time_per_pixel(unsigned long elapsed_us, unsigned long pixels) {
+  unsigned long t = (elapsed_us * BENCH_UNITS_PER_US) /
+    (pixels * BENCH_REPEAT);
+  if (t > 0xFFFF) t = 0xFFFF;
+  return t;
+}
+
+// FUNCTION: reads one result of the stored baseline
+// RUNTIME: O(1)
+uint16_t read_baseline(int i) {
+  return EEPROM.read(2 + 2*i) | (EEPROM.read(3 + 2*i) << 8);
+}
+
+// FUNCTION: records one result; in the last pass, prints the best
+// result of the kernel and compares it to the stored baseline
+// RUNTIME: O(1)
+void report(const char* kernel, const char* variant, uint16_t time,
+            int has_baseline) {
+  int i = bench_index++;
+  if (bench_pass < 0) {
+    return; // warm-up
+  }
+  uint16_t* times = bench_passes[i];
+  times[bench_pass] = time;
+  if (bench_pass < BENCH_PASSES - 1) {
+    return;
+  }
+
+  // sort the passes, so that the best is first and the median
+  // in the middle
+  for (int a = 1; a < BENCH_PASSES; ++a) {
+    uint16_t t = times[a];
+    int b = a;
+    for (; b > 0 && times[b - 1] > t; --b) {
+      times[b] = times[b - 1];
+    }
+    times[b] = t;
+  }
+  uint16_t best = times[0];
+  uint16_t spread = times[BENCH_PASSES / 2] - best;
+  bench_results[i] = best;
+  Serial.print(kernel);
+  Serial.print(" ");
+  Serial.print(variant);
+  Serial.print(": ");
+  Serial.print(best);
+  Serial.print(" ");
+  Serial.print(BENCH_UNIT);
+  if (BENCH_PASSES > 1) {
+    Serial.print(" (spread ");
+    Serial.print(spread);
+    Serial.print(")");
+  }
+
+  if (has_baseline) {
+    uint16_t base = read_baseline(i);
+    Serial.print(" (baseline ");
+    Serial.print(base);
+    Serial.print(")");
+    // result 0 is the reference the others are scaled by
+    if (i > 0 && base > 0 && read_baseline(0) > 0) {
+      unsigned long expected = ((unsigned long) base * bench_results[0] +
+				read_baseline(0) / 2) / read_baseline(0);
+      // a difference no bigger than the rounding to whole
+      // BENCH_UNITs is not a regression
+      unsigned long allowed = expected * BENCH_TOLERANCE / 100;
+      if (allowed < 1) allowed = 1;
+      if (best > expected + allowed) {
+	Serial.print(" REGRESSION");
+	++bench_failures;
+      }
+    }
+  }
+  Serial.println();
+}
+
+// FUNCTION: writes the results of this run to EEPROM as the new baseline
+// RUNTIME: O(n) - one write per result
+void store_baseline() {
+  EEPROM.write(0, BENCH_MAGIC & 0xFF);
+  EEPROM.write(1, BENCH_MAGIC >> 8);
+  for (int i = 0; i < BENCH_RESULTS; ++i) {
+    EEPROM.write(2 + 2*i, bench_results[i] & 0xFF);
+    EEPROM.write(3 + 2*i, bench_results[i] >> 8);
+  }
+}
+
+// FUNCTION: times each kernel once and reports its time per pixel
+// RUNTIME: O(n^2) - dominated by the store_colour and
+//   initialize_colour_array passes
+void time_kernels(int has_baseline) {
+  char variant[8];
+  unsigned long t;
+
+  bench_index = 0;
+
+  // the reference: the original save_pixel over a full canvas row
+  // per colour, the same work as the save_pixel timings below
+  t = micros();
+  for (int r = 0; r < BENCH_REPEAT; ++r) {
+    for (int c = 0; c < 4; ++c) {
+      for (int y = 0; y < PixelCanvas::HEIGHT; ++y) {
+	for (int i = 0; i < PixelCanvas::WIDTH; ++i) {
+	  reference_save_pixel(&all_pixels.bytes[i/PixelCanvas::PIXELS_PER_BYTE][y], i, BENCH_COLOURS[c]);
+	}
+      }
+    }
+  }
+  report("reference_save_pixel", "",
+	 time_per_pixel(micros() - t, 4UL * PixelCanvas::HEIGHT * PixelCanvas::WIDTH), has_baseline);
+
+  // save_pixel: one full row of the canvas per colour,
+  // grouped by byte alignment
+  for (int x = 0; x < 4; ++x) {
+    t = micros();
+    for (int r = 0; r < BENCH_REPEAT; ++r) {
+      for (int c = 0; c < 4; ++c) {
+	for (int y = 0; y < PixelCanvas::HEIGHT; ++y) {
+	  for (int i = x; i < PixelCanvas::WIDTH;
+	       i += PixelCanvas::PIXELS_PER_BYTE) {
+	    save_pixel(i, y, BENCH_COLOURS[c]);
+	  }
+	}
+      }
+    }
+    sprintf(variant, "x%%4=%d", x);
+    report("save_pixel", variant,
+	   time_per_pixel(micros() - t, 4UL * PixelCanvas::HEIGHT * PixelCanvas::COLUMNS), has_baseline);
+  }
+
+  // bits_to_colour, single pixel: one canvas row per colour
+  for (int c = 0; c < 4; ++c) {
+    int bits = 0b11000000;
+    int two_bits = (bits/3) * c;
+    t = micros();
+    for (int r = 0; r < BENCH_REPEAT; ++r) {
+      for (int i = 0; i < PixelCanvas::WIDTH; ++i) {
+	bits_to_colour(two_bits, bits, i, 0);
+      }
+    }
+    sprintf(variant, "c=%d", c);
+    report("bits_to_colour(px)", variant,
+	   time_per_pixel(micros() - t, PixelCanvas::WIDTH), has_baseline);
+  }
+
+  // bits_to_colour, cursor region: every size at every alignment
+  for (int z = 0; z < 3; ++z) {
+    int size = BENCH_SIZES[z];
+    t = micros();
+    for (int r = 0; r < BENCH_REPEAT; ++r) {
+      for (int x = 0; x < 4; ++x) {
+	bits_to_colour(40 + x, 60, size);
+      }
+    }
+    // each call draws the (size + 1) by (size + 1) cursor region once
+    sprintf(variant, "size=%d", size);
+    report("bits_to_colour(rgn)", variant,
+	   time_per_pixel(micros() - t, 4UL * (size + 1) * (size + 1)),
+	   has_baseline);
+  }
+
+  // store_colour: every shape and size, over all alignments and colours
+  char saved_shape = current_shape;
+  for (int s = 0; s < 3; ++s) {
+    current_shape = BENCH_SHAPES[s];
+    for (int z = 0; z < 3; ++z) {
+      int size = BENCH_SIZES[z];
+
+      // count the pixels in one stamp of this shape and size
+      initialize_colour_array();
+      store_colour(40, 60, size, BLACK);
+      unsigned long stamp_pixels = 0;
+      for (int i = 40/4; i <= (40 + 13)/4; ++i) {
+	for (int j = 60; j <= 60 + 13; ++j) {
+	  for (uint8_t b = all_pixels.bytes[i][j]; b != 0; b >>= 2) {
+	    if (b & 0b11) ++stamp_pixels;
+	  }
+	}
+      }
+
+      t = micros();
+      for (int r = 0; r < BENCH_REPEAT; ++r) {
+	for (int x = 0; x < 4; ++x) {
+	  for (int c = 0; c < 4; ++c) {
+	    store_colour(40 + x, 60, size, BENCH_COLOURS[c]);
+	  }
+	}
+      }
+      sprintf(variant, "%c%d", BENCH_SHAPES[s], size);
+      report("store_colour", variant,
+	     time_per_pixel(micros() - t, 16 * stamp_pixels), has_baseline);
+    }
+  }
+  current_shape = saved_shape;
+
+  // initialize_colour_array: the whole drawing region
+  t = micros();
+  for (int r = 0; r < BENCH_REPEAT; ++r) {
+    initialize_colour_array();
+  }
+  report("initialize_colour_array", "",
+	 time_per_pixel(micros() - t, (unsigned long)PixelCanvas::WIDTH * PixelCanvas::HEIGHT), has_baseline);
+}
+
+// FUNCTION: runs the oracle, then times the kernels and reports the
+// best time per pixel of each over Serial
+// RUNTIME: O(n^2) - BENCH_WARMUP + BENCH_PASSES passes of time_kernels
+void run_benchmarks() {
+  int has_baseline = (EEPROM.read(0) | (EEPROM.read(1) << 8)) == BENCH_MAGIC;
+#ifdef BENCHMARK_RECORD
+  has_baseline = 0;
+#endif
+
+  bench_failures = 0;
+
+  // correctness first: timings of a wrong kernel are meaningless
+  int mismatches = oracle_save_pixel();
+  uint32_t checksum = oracle_store_colour();
+  Serial.print("oracle save_pixel: ");
+  Serial.println(mismatches == 0 ? "OK" : "MISMATCH");
+  Serial.print("oracle store_colour: ");
+  Serial.print(checksum, HEX);
+  Serial.println(checksum == STORE_COLOUR_CHECKSUM ? " OK" : " MISMATCH");
+  if (mismatches != 0 || checksum != STORE_COLOUR_CHECKSUM) {
+    ++bench_failures;
+  }
+
+  for (bench_pass = -BENCH_WARMUP; bench_pass < BENCH_PASSES; ++bench_pass) {
+    time_kernels(has_baseline);
+  }
+
+  if (!has_baseline) {
+    store_baseline();
+    Serial.println("baseline stored");
+  }
+  Serial.print("benchmark done, failures: ");
+  Serial.println(bench_failures);
+}
+
+#endif
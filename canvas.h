@@ -0,0 +1,140 @@
+#ifndef CANVAS_H
+#define CANVAS_H
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+   Packed drawing region, shared by the sketch and the host tools in host/
+
+   - Canvas<W, H, BPP> stores a W by H region at BPP (1, 2 or 4) bits
+   per pixel, so each uint8_t holds 8/BPP horizontally adjacent pixels
+   - bytes[x / PIXELS_PER_BYTE][y] holds pixel x of row y, leftmost
+   pixel in the most significant bits
+   - a raw dump of the canvas is BYTES bytes in that same order
+   - every size is a compile-time constant, so the divisions, shifts
+   and masks below fold into constants and shifts
+*/
+template <int W, int H, int BPP>
+class Canvas {
+ public:
+  enum {
+    WIDTH = W,
+    HEIGHT = H,
+    BITS = BPP,
+    PIXELS_PER_BYTE = 8 / BPP,
+    COLUMNS = W / PIXELS_PER_BYTE, // uint8_ts per row
+    BYTES = COLUMNS * H,
+    MASK = (1 << BPP) - 1, // colour bits of the rightmost pixel in a byte
+    REPEAT = 0xFF / MASK   // times MASK-sized value fills a whole byte
+  };
+
+  uint8_t bytes[COLUMNS][H];
+
+  // FUNCTION: position of pixel x's colour bits within its uint8_t
+  // RETURNS: number of bits to shift right to reach them
+  // RUNTIME: O(1)
+  static uint8_t shift(int x) {
+    return (PIXELS_PER_BYTE - 1 - (unsigned) x % PIXELS_PER_BYTE) * BPP;
+  }
+
+  // FUNCTION: selects the colour bits of one pixel of a packed uint8_t
+  // RETURNS: colour bits of pixel x, where only x % PIXELS_PER_BYTE matters
+  // RUNTIME: O(1)
+  static uint8_t unpack(uint8_t packed, int x) {
+    return (packed >> shift(x)) & MASK;
+  }
+
+  // FUNCTION: finds the pixels of a packed uint8_t that are not
+  // colour bits 0 (white)
+  // RETURNS: mask with all colour bits of those pixels set
+  // RUNTIME: O(1)
+  static uint8_t drawn_mask(uint8_t packed) {
+    // collect each pixel's bits into its lowest bit, then spread back
+    for (int s = 1; s < BPP; s <<= 1) {
+      packed |= packed >> s;
+    }
+    return (packed & REPEAT) * MASK;
+  }
+
+  // FUNCTION: reads the colour bits of a single pixel
+  // RUNTIME: O(1)
+  uint8_t get(int x, int y) const {
+    return unpack(bytes[(unsigned) x / PIXELS_PER_BYTE][y], x);
+  }
+
+  // FUNCTION: writes the colour bits of a single pixel
+  // RUNTIME: O(1)
+  void set(int x, int y, uint8_t bits) {
+    uint8_t s = shift(x);
+    uint8_t& packed = bytes[(unsigned) x / PIXELS_PER_BYTE][y];
+    packed = (packed & ~(MASK << s)) | (bits << s);
+  }
+
+  // FUNCTION: sets pixels x0 to x1 - 1 of row y to the same colour,
+  // a whole uint8_t at a time where possible
+  // RUNTIME: O(n) - length of the span
+  void fill_span(int x0, int x1, int y, uint8_t bits) {
+    for (; x0 < x1 && (unsigned) x0 % PIXELS_PER_BYTE != 0; ++x0) {
+      set(x0, y, bits);
+    }
+    for (; x0 + PIXELS_PER_BYTE <= x1; x0 += PIXELS_PER_BYTE) {
+      bytes[(unsigned) x0 / PIXELS_PER_BYTE][y] = bits * REPEAT;
+    }
+    for (; x0 < x1; ++x0) {
+      set(x0, y, bits);
+    }
+  }
+
+  // FUNCTION: sets every pixel to colour bits 0
+  // RUNTIME: O(n^2) - all rows AND columns
+  void clear() {
+    memset(bytes, 0, sizeof(bytes));
+  }
+
+  // FUNCTION: calls f(x, y, colour bits) for every pixel in columns
+  // x0 to x1 - 1 of rows y0 to y1 - 1, row by row
+  // RUNTIME: O(n^2) - every row AND column of the region
+  template <class F>
+  void for_each(int x0, int y0, int x1, int y1, F& f) const {
+    for (int y = y0; y < y1; ++y) {
+      for (int x = x0; x < x1; ++x) {
+	f(x, y, get(x, y));
+      }
+    }
+  }
+};
+
+// geometry of the drawing region; the icon bar, cursor limits and icon
+// clicks in the sketch are laid out for this region of the 128x160 lcd,
+// so only the colour depth can be changed with -D (CANVAS_BPP=1 for a
+// black and white canvas; the host tools also take 4)
+#if defined(CANVAS_WIDTH) || defined(CANVAS_HEIGHT)
+#error "the drawing region is fixed at 128x136; only CANVAS_BPP can be set"
+#endif
+#define CANVAS_WIDTH 128
+#define CANVAS_HEIGHT 136
+#ifndef CANVAS_BPP
+#define CANVAS_BPP 2
+#endif
+
+#ifdef __AVR__
+#include <avr/io.h>
+// the rest of the sketch (the SD library's block buffer, erased_bytes in
+// autosave.cpp, the Serial buffers and the stack) needs about 3 KB of
+// the SRAM; at 4 bits per pixel the canvas alone takes 8704 bytes
+#if CANVAS_WIDTH / 8 * CANVAS_HEIGHT * CANVAS_BPP > \
+  RAMEND - RAMSTART + 1 - 3072
+#error "the canvas does not fit in SRAM at this CANVAS_BPP; use 1 or 2"
+#endif
+#endif
+
+typedef Canvas<CANVAS_WIDTH, CANVAS_HEIGHT, CANVAS_BPP> PixelCanvas;
+
+// 16 bit (5-6-5) colour of colour bits 0-3: the sketch draws the canvas
+// with these (PALETTE in functions.h, which checks them against
+// ST7735_WHITE, ST7735_BLACK, ST7735_RED and ST7735_BLUE), and the
+// host tools render dumps with them
+const uint16_t CANVAS_RGB565[4] = {0xFFFF, 0x0000, 0xF800, 0x001F};
+
+#endif
@@ -3,33 +3,37 @@
 #include <Adafruit_ST7735.h> // Hardware-specific library
 #include <SPI.h>
 #include <SD.h>
+#include "canvas.h"
 #include "functions.h"
 
 
 // FUNCTION: draws and displays the icons at the bottom
 // RUNTIME: O(1)
 void draw_background() {
+  // the icons fill the lcd below the drawing region and its border
+  const int top = PixelCanvas::HEIGHT + 1;
+  const int height = HEIGHT - top;
 
   // top horizontal line
-  tft.drawLine(0, 136, WIDTH-1, 136, BLACK);
+  tft.drawLine(0, PixelCanvas::HEIGHT, WIDTH-1, PixelCanvas::HEIGHT, BLACK);
 
   // 4 vertical dividers
-  tft.drawLine(24, 137, 24, HEIGHT-1, BLACK);
-  tft.drawLine(50, 137, 50, HEIGHT-1, BLACK);
-  tft.drawLine(76, 137, 76, HEIGHT-1, BLACK);
-  tft.drawLine(102, 137, 102, HEIGHT-1, BLACK);
+  tft.drawLine(24, top, 24, HEIGHT-1, BLACK);
+  tft.drawLine(50, top, 50, HEIGHT-1, BLACK);
+  tft.drawLine(76, top, 76, HEIGHT-1, BLACK);
+  tft.drawLine(102, top, 102, HEIGHT-1, BLACK);
 
   if(cursor_x <= 24 || start == 1) {
     // colour palatte - 1st from left
-    tft.fillRect(0, 137, 12, 12, BLACK);
-    tft.fillRect(12, 137, 12, 12, RED);
+    tft.fillRect(0, top, 12, 12, BLACK);
+    tft.fillRect(12, top, 12, 12, RED);
     tft.fillRect(0, 148, 12, 12, WHITE);
     tft.fillRect(12, 148, 12, 12, BLUE);
   }
 
   if((cursor_x > 24-cursor_size && cursor_x <=50) || start == 1) {
     // pencil - 2nd from left
-    tft.fillRect(25, 137, 25, 23, WHITE);
+    tft.fillRect(25, top, 25, height, WHITE);
     tft.fillRoundRect(33, 152, 9, 6, 2, MAGENTA); // eraser
     tft.fillRect(33, 145, 9, 9, 0xFBE0); // body 
     tft.fillTriangle(33, 144, 41, 144, 37, 138, YELLOW); // pointed end
@@ -39,14 +43,14 @@ void draw_background() {
 
   if((cursor_x > 50-cursor_size && cursor_x <= 76) || start == 1) {
     // eraser - 3rd from left
-    tft.fillRect(51, 137, 25, 23, WHITE);
+    tft.fillRect(51, top, 25, height, WHITE);
     tft.fillRoundRect(59, 140, 10, 11, 2, MAGENTA);
     tft.fillRoundRect(59, 151, 10, 6, 2, BLUE);
     tft.fillRect(59, 150, 10, 2, BLUE);
   }
 
   // cursor style - 4th from left
-  tft.fillRect(77, 137, 25, 23, WHITE);
+  tft.fillRect(77, top, 25, height, WHITE);
   
   if(current_shape == 'r') { // square
     tft.fillRect(85, 145, 8, 8, current_colour);
@@ -67,29 +71,55 @@ void draw_background() {
 
   if((cursor_x > 102-cursor_size) || start == 1) {
     // clear icon ('X') - 5th from left
-    tft.fillRect(103, 137, 25, 23, WHITE);
-    tft.drawLine(103, 137, WIDTH-1, HEIGHT-1, RED);
-    tft.drawLine(103, HEIGHT-1, WIDTH-1, 137, RED);
+    tft.fillRect(103, top, 25, height, WHITE);
+    tft.drawLine(103, top, WIDTH-1, HEIGHT-1, RED);
+    tft.drawLine(103, HEIGHT-1, WIDTH-1, top, RED);
   }
 }
 
-// FUNCTION: changes pencil colour to colour selected
+// FUNCTION: finds the colour swatch under the cursor
+// RETURNS: colour of the swatch, or the current colour if the
+// cursor is on the border between swatches
 // RUNTIME: O(1)
-void change_colour() {
+int swatch_colour() {
   int half_cursor = cursor_size/2;
   int x = cursor_x+half_cursor;
   int y = cursor_y+half_cursor;
 
   // each colour is a different region
   if(x < 12 && y < 148) {
-    current_colour = BLACK;
+    return BLACK;
   } else if(x < 12 && y > 148) {
-    current_colour = WHITE;
+    return WHITE;
   } else if(x > 12 && y < 148) {
-    current_colour = RED;
+    return RED;
   } else if(x > 12 && y > 148) {
-    current_colour = BLUE;
+    return BLUE;
   }
+  return current_colour;
+}
+
+// FUNCTION: changes pencil colour to colour selected
+// RUNTIME: O(1)
+void change_colour() {
+  current_colour = swatch_colour();
+}
+
+// FUNCTION: swaps the pencil colour and the colour selected everywhere
+// in the drawing, and makes the selected colour the pencil colour;
+// swapping back with the old pencil colour undoes it
+// RUNTIME: O(n^2) - see remap_canvas
+void swap_colours() {
+  int colour = swatch_colour();
+  if (colour == current_colour) return;
+
+  uint8_t map[4] = {0, 1, 2, 3};
+  uint8_t from = colour_to_bits(current_colour);
+  uint8_t to = colour_to_bits(colour);
+  map[from] = to;
+  map[to] = from;
+  remap_canvas(map);
+  current_colour = colour;
 }
 
 // FUNCTION: saves previous state of the pencil and turns cursor to an eraser
@@ -113,8 +143,10 @@ void pencil() {
 // RUNTIME: O(1)
 void clear() {
   // paint white rectangle over drawing surface
-  tft.fillRect(0, 0, WIDTH-1, 136, WHITE);
+  tft.fillRect(0, 0, PixelCanvas::WIDTH, PixelCanvas::HEIGHT, WHITE);
   initialize_colour_array();
+  cancel_restore(); // don't bring back the old drawing
+  canvas_changed = 1;
 }
 
 // FUNCTION: changes the shape when user clicks on the changing shape icon
@@ -229,7 +261,7 @@ void bounds() {
   }
 
   // if in icons region, redraw to account for cursor movement
-  if((cursor_y > 136 - (size + 1)) &&
+  if((cursor_y > PixelCanvas::HEIGHT - (size + 1)) &&
      ((cursor_x != prev_cursor_x) || (cursor_y != prev_cursor_y) || 
       icon_click == 1)) {
     draw_background();
@@ -239,100 +271,83 @@ void bounds() {
 // FUNCTION: records all pixels in drawing space as white
 // RUNTIME: O(n^2) - iterates through all rows AND columns
 void initialize_colour_array() {
-  for (int i = 0; i < 32; ++i) {
-    for (int j = 0; j < 136; ++j) {
-      all_pixels[i][j] = 0;
-    }
-  }
+  all_pixels.clear();
 }
 
+// draws each pixel it is given in its stored colour; used with
+// PixelCanvas::for_each to redraw a region of the drawing
+struct RedrawPixel {
+  void operator()(int x, int y, uint8_t bits) {
+    tft.drawPixel(x, y, PALETTE[bits]);
+  }
+};
+
 // FUNCTION: redraws the pixels in the region through which the cursor
 // passes so that cursor movement does not change the drawing
 // unintentionally
-// RUNTIME: O(n^2) 
-//     - one for loop
-//     - two twice-nested for loops 
-//     - while loop simply multiplies by the constant 1, 2, or 3
-//     => twice-nested for loop has largest growth rate and so 
-//        determines running time
+// RUNTIME: O(n^2) - every row AND column of the cursor region
 void bits_to_colour(int prev_cursor_x, int prev_cursor_y, int cursor_size) {
-    
-  int temp_cursor_x = prev_cursor_x;
-  int two_bits;
-  int x_offset = temp_cursor_x % 4;
-    
-  // to redraw for cursors of different sizes
-  int cursor_tracker = cursor_size/4;
-    
-  while (cursor_tracker > 0) {
-    /*
-      The binary numbers 0b11000000, 0b00110000, 0b00001100, 0b00000011
-      are used to "select" from one uint8_t element in the pixels array
-      the two bits of interest (i.e. the colour of a single pixel of
-      interest).  These numbers correspond, in the order above, to decimal
-      192, 48, 12, 3, which are all 3*(a multiple of 4).  The loop below
-      generates the necessary value for a particular horizontal coordinate
-      of a pixel.
-    */
-    int bits = 3;
-    for (int i = 0; i < (4 - x_offset) - 1; ++i) {
-      bits *= 4;
-    }
-        
-    /*
-      We look at groups of 4 horizontally adjacent pixels because this
-      works well with the size of a uint8, and makes changing the cursor
-      size by multiples of 4 convenient.
-    */
-        
-    // redraw the colours in the 1st columm of uint8s used to store the
-    // 4 pixels
-    for (int i = temp_cursor_x;
-	 i < temp_cursor_x + 4 - x_offset;
-	 ++i, bits /= 4) {
-      for (int j = prev_cursor_y; 
-	   j < prev_cursor_y + cursor_size + 1;
-	   ++j) {
-	if (j > 135) break; // don't redraw over icons
-	two_bits = bits & all_pixels[temp_cursor_x/4][j];
-	bits_to_colour(two_bits, bits, i, j);
-      }
-    }
-        
-    // redraw the colours in the 2nd column of uint8s used to store the
-    // 4 pixels
-    for (int i = temp_cursor_x + 4 - x_offset, bits = 192;
-	 i < temp_cursor_x + 4 + 1; // "+1" for extra width of circle
-	 ++i, bits /= 4) {
-      for (int j = prev_cursor_y; 
-	   j < prev_cursor_y + cursor_size + 1;  
-	   ++j) {
-	if(j > 135) break; // don't redraw over icons
-	two_bits = bits & all_pixels[temp_cursor_x/4 + 1][j];
-	bits_to_colour(two_bits, bits, i, j);
-      }
-    }
-        
-    --cursor_tracker;
-    temp_cursor_x += 4;
-  }   
+  // "+1" for extra width and height of circle
+  int x_end = prev_cursor_x + cursor_size + 1;
+  int y_end = prev_cursor_y + cursor_size + 1;
+
+  // don't redraw over icons or past the right edge
+  if (x_end > PixelCanvas::WIDTH) x_end = PixelCanvas::WIDTH;
+  if (y_end > PixelCanvas::HEIGHT) y_end = PixelCanvas::HEIGHT;
+
+  RedrawPixel redraw;
+  all_pixels.for_each(prev_cursor_x, prev_cursor_y, x_end, y_end, redraw);
 }
 
-// FUNCTION: redraws a single pixel
+// FUNCTION: redraws a single pixel, given its colour bits (two_bits)
+// still in place within the mask (bits) that selected them
 // RUNTIME: O(1)
 void bits_to_colour(int two_bits, int bits, int x, int y) {
 
-  // compare 2 bits of interest to reference bits
-  // to determine the colour to draw
-  if (two_bits == 0) {
-    tft.drawPixel(x, y, WHITE);
-  } else if (two_bits == bits/3) {
-    tft.drawPixel(x, y, BLACK);
-  } else if (two_bits == bits*2/3) {
-    tft.drawPixel(x, y, RED);
-  } else if (two_bits == bits) {
-    tft.drawPixel(x, y, BLUE);
+  // shift the colour bits down until the mask covers the lowest bits
+  while (bits > PixelCanvas::MASK) {
+    bits >>= PixelCanvas::BITS;
+    two_bits >>= PixelCanvas::BITS;
+  }
+  tft.drawPixel(x, y, PALETTE[two_bits]);
+}
+
+// FUNCTION: saves the colour bits of a single pixel; inlined into
+// store_colour so that a stamp looks up its colour bits only once
+// RUNTIME: O(1)
+static inline void save_bits(int x, int y, uint8_t bits) {
+  // stamps near the right edge or the icons reach past the drawing
+  // region, and writing there would change other pixels
+  if ((unsigned) x >= PixelCanvas::WIDTH ||
+      (unsigned) y >= PixelCanvas::HEIGHT) {
+    return;
+  }
+  all_pixels.set(x, y, bits);
+}
+
+// FUNCTION: sets pixels x0 to x1 - 1 of row y to the same colour bits,
+// leaving out the ones outside the drawing region
+// RUNTIME: O(n) - length of the span
+static void save_span(int x0, int x1, int y, uint8_t bits) {
+  if ((unsigned) y >= PixelCanvas::HEIGHT) {
+    return;
+  }
+  all_pixels.fill_span(max(x0, 0), min(x1, (int) PixelCanvas::WIDTH),
+		       y, bits);
+}
+
+// FUNCTION: finds how much shorter row j of the circle stamp is than
+// its box at each end; the shape depends on the size (4, 8 or 12)
+// RETURNS: number of pixels left out at each end of the row
+// RUNTIME: O(1)
+static int circle_inset(int cursor_size, int j) {
+  int edge = min(j, cursor_size - j); // rows to the top or bottom
+  if (cursor_size == 4) {
+    return edge == 0 ? 1 : 0;
+  } else if (cursor_size == 8) {
+    return edge == 0 ? 3 : (edge < 3 ? 1 : 0);
   }
+  return edge < 4 ? 4 - edge : 0;
 }
 
 // FUNCTION: stores the colour drawn by the cursor in a 
@@ -344,88 +359,32 @@ void bits_to_colour(int two_bits, int bits, int x, int y) {
 //       and so determines running time
 void store_colour(int cursor_x, int cursor_y, 
                   int cursor_size, int current_colour) {
+  canvas_changed = 1;
+  // every pixel of the stamp has the same colour bits
+  uint8_t bits = colour_to_bits(current_colour);
+
+  // erased pixels look like blank ones, so the restore of the saved
+  // drawing is told where the eraser went (see autosave.cpp)
+  if (bits == 0 && restore_pending) {
+    // "+1" for extra width and height of circle
+    mark_erased(cursor_x, cursor_y, cursor_x + cursor_size + 1,
+		cursor_y + cursor_size + 1);
+  }
 
   if (current_shape == 'r') { // square of pixels
-    for (int i = cursor_x; i < cursor_x + cursor_size; ++i) {
-      for (int j = cursor_y; j < cursor_y + cursor_size; ++j) {
-	save_pixel(i, j, current_colour);
-      }
-            
+    for (int j = cursor_y; j < cursor_y + cursor_size; ++j) {
+      save_span(cursor_x, cursor_x + cursor_size, j, bits);
     }
 
   } else if (current_shape == 'c') { // circle of pixels
-    // the shape of the circle is dependent on its size,
-    // so there are 3 cases     
-    if (cursor_size == 4) { // small cursor
-
-      // save the rows of length cursor_size + 1
-      for (int i = cursor_x; i < cursor_x + cursor_size + 1; ++i) {
-	for (int j = cursor_y + 1; 
-	     j < cursor_y + cursor_size; 
-	     ++j) {
-	  save_pixel(i, j, current_colour);
-	}
-      }
-
-      // save the rows of length cursor_size - 1
-      for (int i = cursor_x + 1; i < cursor_x + cursor_size; ++i) {
-	save_pixel(i, cursor_y, current_colour);
-	save_pixel(i, cursor_y + cursor_size, current_colour);
-      }    
-        
-    } else if (cursor_size == 8) { // medium cursor
-
-      // save the rows of length cursor_size + 1
-      for (int i = cursor_x; i < cursor_x + cursor_size + 1; ++i) {
-	for (int j = cursor_y + 3; 
-	     j < cursor_y + 6; 
-	     ++j) {
-	  save_pixel(i, j, current_colour);
-	}
-      }      
-
-      // save the rows of length cursor_size - 1
-      for (int i = cursor_x + 1; i < cursor_x + cursor_size; ++i) {
-	for (int j = cursor_y + 1; 
-	     j < cursor_y + 3; 
-	     ++j) {
-	  save_pixel(i, j, current_colour);
-	  save_pixel(i, j + 5, current_colour);
-	}
-      }
-
-      // save the rows of length cursor_size - 3
-      for (int i = cursor_x + 3; i < cursor_x + 6; ++i) { 
-	save_pixel(i, cursor_y, current_colour);
-	save_pixel(i, cursor_y + cursor_size, current_colour);
-      }
-
-    } else if (cursor_size == 12) { // large cursor
-            
-      // save the rows of length cursor_size + 1
-      for (int i = cursor_x; i < cursor_x + cursor_size + 1; ++i) {
-	for (int j = cursor_y + 4; 
-	     j < cursor_y + 9; 
-	     ++j) {
-	  save_pixel(i, j, current_colour);
-	}
-      }      
-            
-      // save all other rows, which have lengths in increments
-      // of 2 between 5 and 11
-      int x_start = cursor_x + 4;
-      int x_end = cursor_x + 8;
-      int j = cursor_y;
-      int y_index_incr = 12;            
-      for (; x_start > cursor_x; 
-	   --x_start, ++x_end, ++j, y_index_incr -= 2) {
-	for (int i = x_start; i <= x_end; ++i) {
-	  save_pixel(i, j, current_colour);
-	  save_pixel(i, j + y_index_incr, current_colour);
-	}
-      }
+    // each row is a span across the (cursor_size + 1) wide box,
+    // shortened at both ends near the top and bottom
+    for (int j = 0; j <= cursor_size; ++j) {
+      int inset = circle_inset(cursor_size, j);
+      save_span(cursor_x + inset, cursor_x + cursor_size + 1 - inset,
+		cursor_y + j, bits);
     }
-        
+
   } else if (current_shape == 's') { 
     // line of pixels from top right to bottom left of
     // cursor_size X cursor_size "box" 
@@ -433,61 +392,161 @@ void store_colour(int cursor_x, int cursor_y,
     int i, j;
     for (i = cursor_x + cursor_size - 1, j = cursor_y; 
 	 i >= cursor_x; --i, ++j) { 
-      save_pixel(i, j, current_colour);            
+      save_bits(i, j, bits);            
       if (i == cursor_x) {
 	// don't add extra pixels on the end of the line
 	break;
       }          
-      save_pixel(i - 1, j, current_colour);
-      save_pixel(i, j + 1, current_colour);
+      save_bits(i - 1, j, bits);
+      save_bits(i, j + 1, bits);
     }       
   }
 } 
 
-// FUNCTION: saves the colour of a single pixel
+// FUNCTION: saves the colour of a single pixel, which must be
+// in the drawing region
 // RUNTIME: O(1)
 void save_pixel(int x, int y, int colour) {
+  all_pixels.set(x, y, colour_to_bits(colour));
+}
 
-  // position of the 2 bits in the uint8_t that 
-  // store the pixel
-  int hori_offset = x % 4;  
-   
-  // x_index in the array
-  int x_block = x/4;
-
-  // bits to "select" the 2 bits of interest
-  // from 8 in a uint8_t
-  uint8_t bits = 0b11000000 >> 2*hori_offset;
-    
-  // bits to "select" from
-  uint8_t white_bits = 0b00000000;
-  uint8_t black_bits = 0b01010101;
-  uint8_t red_bits = 0b10101010;
-  uint8_t blue_bits = 0b11111111;
-
-  uint8_t and_bits;
-  uint8_t or_bits;
-    
-  // generate 2 uint8_t values:
-  // - one to "and" with the element of all_pixel, and
-  // - one to "or" with the element of all pixels
-  // in order to update the 2 bits of interest appropriately
+// FUNCTION: translates a colour to the bits that store it
+// RETURNS: 0b00 (white), 0b01 (black), 0b10 (red), 0b11 (blue);
+// with 1 bit per pixel, every colour but white is stored as black
+// RUNTIME: O(1)
+uint8_t colour_to_bits(int colour) {
   if (colour == WHITE) {
-    or_bits = bits & white_bits;
-    and_bits = ~bits | white_bits;
-  } else if (colour == BLACK) {
-    or_bits = bits & black_bits;
-    and_bits = ~bits | black_bits;
+    return 0;
+  } else if (colour == BLACK || PixelCanvas::MASK == 1) {
+    return 1;
   } else if (colour == RED) {
-    or_bits = bits & red_bits;
-    and_bits = ~bits | red_bits;
+    return 2;
   } else if (colour == BLUE) {
-    or_bits = bits & blue_bits;
-    and_bits = ~bits | blue_bits;
+    return 3;
   }
-    
-  // bit-wise update of the contents of the all
-  // pixels array
-  all_pixels[x_block][y] &= and_bits;
-  all_pixels[x_block][y] |= or_bits;
+  return 0;
+}
+
+// FUNCTION: replaces one colour with another in the whole drawing
+// RUNTIME: O(n^2) - see remap_canvas
+void replace_colour(int from, int to) {
+  if (from == to) return;
+
+  uint8_t map[4] = {0, 1, 2, 3};
+  map[colour_to_bits(from)] = colour_to_bits(to);
+  remap_canvas(map);
+}
+
+// FUNCTION: changes every pixel of colour bits i in the drawing to
+// colour bits map[i], then repaints the rows that changed
+// RUNTIME: O(n^2) - iterates through all rows AND columns
+void remap_canvas(const uint8_t map[4]) {
+  /*
+    Each uint8_t holds several pixels, so every possible byte can be
+    remapped ahead of time: table[b] is b with each of its pixels
+    remapped. The canvas is then updated with one lookup per byte.
+    Colour bits above 3 (only possible with 4 bits per pixel) are kept.
+  */
+  uint8_t table[256];
+  for (int b = 0; b < 256; ++b) {
+    table[b] = 0;
+    for (int x = 0; x < PixelCanvas::PIXELS_PER_BYTE; ++x) {
+      uint8_t bits = PixelCanvas::unpack(b, x);
+      if (bits < 4) bits = map[bits] & PixelCanvas::MASK;
+      table[b] |= bits << PixelCanvas::shift(x);
+    }
+  }
+
+  for (int j = 0; j < PixelCanvas::HEIGHT; ++j) {
+    for (int i = 0; i < PixelCanvas::COLUMNS; ++i) {
+      uint8_t remapped = table[all_pixels.bytes[i][j]];
+      if (remapped != all_pixels.bytes[i][j]) {
+	all_pixels.bytes[i][j] = remapped;
+	changed_rows[j/8] |= 1 << (j % 8);
+	canvas_changed = 1;
+      }
+    }
+  }
+  repaint_changed_rows();
+
+  if (restore_pending) {
+    remap_restore(map);
+  }
+}
+
+// FUNCTION: redraws every row marked in changed_rows, each
+// as one burst of pixels, and unmarks them
+// RUNTIME: O(n^2) - worst case every row AND column
+void repaint_changed_rows() {
+  for (int j = 0; j < PixelCanvas::HEIGHT; ++j) {
+    if (!(changed_rows[j/8] & (1 << (j % 8)))) continue;
+
+    // one address window for the whole row, then stream the colours
+    tft.setAddrWindow(0, j, PixelCanvas::WIDTH-1, j);
+    for (int i = 0; i < PixelCanvas::COLUMNS; ++i) {
+      uint8_t packed = all_pixels.bytes[i][j];
+      for (int k = 0; k < PixelCanvas::PIXELS_PER_BYTE; ++k) {
+	tft.pushColor(PALETTE[PixelCanvas::unpack(packed, k)]);
+      }
+    }
+  }
+  memset(changed_rows, 0, sizeof(changed_rows));
+}
+
+// FUNCTION: records that the region of a stamp at (x, y) needs to be
+// drawn, merging it with any recorded region it overlaps or touches
+// RUNTIME: O(n^2) - a merge can make the result touch other regions,
+// so the regions are checked again after each merge
+void mark_dirty(int x, int y, int size) {
+  // "+1" for extra width and height of circle
+  DirtyRect rect = {x, y, x + size + 1, y + size + 1};
+  if (rect.x1 > PixelCanvas::WIDTH) rect.x1 = PixelCanvas::WIDTH;
+  if (rect.y1 > PixelCanvas::HEIGHT) rect.y1 = PixelCanvas::HEIGHT;
+
+  for (int i = 0; i <= dirty_count; ++i) {
+    if (i == dirty_count) {
+      if (dirty_count < MAX_DIRTY_RECTS) break;
+      // no room left: merge with the last region, which can make
+      // rect touch the others, so the loop still starts over
+      i = dirty_count - 1;
+    } else {
+      const DirtyRect& other = dirty_rects[i];
+      if (rect.x0 > other.x1 || other.x0 > rect.x1 ||
+	  rect.y0 > other.y1 || other.y0 > rect.y1) {
+	continue;
+      }
+    }
+
+    // take the other region out of the list, grow rect to cover
+    // both, and start over
+    const DirtyRect& other = dirty_rects[i];
+    rect.x0 = min(rect.x0, other.x0);
+    rect.y0 = min(rect.y0, other.y0);
+    rect.x1 = max(rect.x1, other.x1);
+    rect.y1 = max(rect.y1, other.y1);
+    dirty_rects[i] = dirty_rects[--dirty_count];
+    i = -1;
+  }
+  dirty_rects[dirty_count++] = rect;
+}
+
+// FUNCTION: draws every recorded region from all_pixels, each as one
+// burst of pixels, and starts a new frame
+// RUNTIME: O(n^2) - every row AND column of the regions
+void flush_dirty() {
+  if (dirty_count == 0) return;
+
+  for (int r = 0; r < dirty_count; ++r) {
+    const DirtyRect& rect = dirty_rects[r];
+
+    // one address window for the region, then stream the colours
+    tft.setAddrWindow(rect.x0, rect.y0, rect.x1 - 1, rect.y1 - 1);
+    for (int y = rect.y0; y < rect.y1; ++y) {
+      for (int x = rect.x0; x < rect.x1; ++x) {
+	tft.pushColor(PALETTE[all_pixels.get(x, y)]);
+      }
+    }
+  }
+  dirty_count = 0;
+  frame_start = millis();
 }
@@ -1,6 +1,8 @@
 #ifndef FUNCTIONS_H
 #define FUNCTIONS_H
 
+#include "canvas.h"
+
 // standard U of A library settings, assuming Atmel Mega SPI pins
 #define SD_CS    5  // Chip select line for SD card
 #define TFT_CS   6  // Chip select line for TFT display
@@ -9,7 +11,7 @@
 
 // constructor that implements the changes to the lcd screen
 extern Adafruit_ST7735 tft;
-//extern Sd2Card card;
+extern Sd2Card card;
 
 #define WHITE ST7735_WHITE
 #define BLACK ST7735_BLACK
@@ -20,6 +22,11 @@ extern Adafruit_ST7735 tft;
 #define BLUE ST7735_BLUE
 #define MAGENTA ST7735_MAGENTA
 
+// the canvas colours in canvas.h are drawn with the lcd colours above
+#if WHITE != 0xFFFF || BLACK != 0x0000 || RED != 0xF800 || BLUE != 0x001F
+#error "CANVAS_RGB565 in canvas.h does not match the lcd colours"
+#endif
+
 // Constants for LCD screen
 extern const int WIDTH;
 extern const int HEIGHT;
@@ -54,7 +61,25 @@ extern int y_bound;
 extern int pencil_colour; // declares variables to store previous pencil mode
 extern char pencil_shape; // when user returns from eraser mode
 
-extern uint8_t all_pixels[32][136];
+extern PixelCanvas all_pixels;
+#define PALETTE CANVAS_RGB565 // colour of each colour bits value
+// one bit per row of all_pixels
+extern uint8_t changed_rows[(PixelCanvas::HEIGHT + 7)/8];
+
+// region of the drawing from (x0, y0) up to but not including (x1, y1)
+struct DirtyRect {
+  int x0, y0, x1, y1;
+};
+extern const int MAX_DIRTY_RECTS;
+extern const unsigned long FRAME_MS; // how often stamps are drawn
+extern DirtyRect dirty_rects[]; // stored but not yet drawn
+extern int dirty_count;
+extern unsigned long frame_start;
+
+extern int canvas_changed; // drawing has changed since the last autosave
+extern unsigned long last_input; // when the joystick or dial was last used
+extern int restore_pending; // a saved drawing may still be restored
+
 extern int start; // to make sure icons are drawn at start
 // ensures that the cursor and style icon updates immediately 
 extern int icon_click; 
@@ -66,6 +91,8 @@ void initialize_colour_array();
 void eraser();
 void clear();
 void change_colour();
+int swatch_colour();
+void swap_colours();
 void draw_cursor(int, int, int, char, int);
 void change_shape();
 int size_selection(int);
@@ -76,5 +103,19 @@ void store_colour(int, int, int, int);
 void bounds();
 void pencil();
 void save_pixel(int, int, int);
+uint8_t colour_to_bits(int);
+void replace_colour(int, int);
+void remap_canvas(const uint8_t[4]);
+void repaint_changed_rows();
+void mark_dirty(int, int, int);
+void flush_dirty();
+void run_benchmarks();
+void start_sd();
+void cancel_restore();
+void mark_erased(int, int, int, int);
+void remap_restore(const uint8_t[4]);
+void restore_band();
+void save_canvas();
+void storage_step();
 
 #endif
@@ -0,0 +1,344 @@
+// Project: Pixel Paint - host batch renderer
+// Converts a directory of raw all_pixels dumps to PNG or PPM images
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "canvas.h"
+
+// number of different colour bits values in a dump
+const int COLOURS = PixelCanvas::MASK + 1;
+
+struct Options {
+  int threads;
+  int scale; // 1, 2, 4 or 8
+  bool png;  // otherwise PPM
+  std::string input_dir;
+  std::string output_dir;
+};
+
+// FUNCTION: prints how to use the program
+// RUNTIME: O(1)
+void usage(const char* program) {
+  fprintf(stderr,
+	  "usage: %s [-j threads] [-s 1|2|4|8] [-f png|ppm] "
+	  "<input dir> <output dir>\n"
+	  "converts every %d byte all_pixels dump in <input dir>\n",
+	  program, (int) PixelCanvas::BYTES);
+}
+
+// FUNCTION: decodes a raw dump into one palette index per pixel,
+// upscaled by nearest neighbour
+// RUNTIME: O(n^2) - every row AND column of the output image
+void decode(const uint8_t* dump, int scale, std::vector<uint8_t>& indices) {
+  // a dump is a copy of all_pixels.bytes, so it is read back through
+  // the same class that wrote it
+  PixelCanvas canvas;
+  memcpy(canvas.bytes, dump, PixelCanvas::BYTES);
+
+  int width = PixelCanvas::WIDTH * scale;
+  indices.resize((size_t) width * PixelCanvas::HEIGHT * scale);
+
+  for (int y = 0; y < PixelCanvas::HEIGHT; ++y) {
+    uint8_t* row = &indices[(size_t) y * scale * width];
+    for (int x = 0; x < PixelCanvas::WIDTH; ++x) {
+      memset(row + x * scale, canvas.get(x, y), scale);
+    }
+    // the other rows of the scaled pixel are copies of the first
+    for (int k = 1; k < scale; ++k) {
+      memcpy(row + (size_t) k * width, row, width);
+    }
+  }
+}
+
+// FUNCTION: expands a 5-6-5 colour to 8 bits per channel
+// RUNTIME: O(1)
+void rgb565_to_rgb(uint16_t colour, uint8_t rgb[3]) {
+  rgb[0] = ((colour >> 11) & 0x1F) * 255 / 31;
+  rgb[1] = ((colour >> 5) & 0x3F) * 255 / 63;
+  rgb[2] = (colour & 0x1F) * 255 / 31;
+}
+
+// FUNCTION: looks up the colour of a colour bits value; values above 3
+// (only possible with 4 bits per pixel) are never drawn, show as white
+// RUNTIME: O(1)
+uint16_t colour_of(int bits) {
+  return bits < 4 ? CANVAS_RGB565[bits] : CANVAS_RGB565[0];
+}
+
+// FUNCTION: appends a 32 bit big-endian value
+// RUNTIME: O(1)
+void put_u32(std::vector<uint8_t>& out, uint32_t value) {
+  out.push_back(value >> 24);
+  out.push_back(value >> 16);
+  out.push_back(value >> 8);
+  out.push_back(value);
+}
+
+// FUNCTION: builds the lookup table for crc32
+// RUNTIME: O(n) - 256 entries, 8 steps each
+std::vector<uint32_t> crc32_table() {
+  std::vector<uint32_t> table(256);
+  for (uint32_t n = 0; n < 256; ++n) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; ++k) {
+      c = (c & 1) ? 0xEDB88320UL ^ (c >> 1) : c >> 1;
+    }
+    table[n] = c;
+  }
+  return table;
+}
+
+// FUNCTION: computes the CRC-32 used by PNG chunks
+// RUNTIME: O(n) - one table lookup per byte
+uint32_t crc32(const uint8_t* data, size_t length) {
+  // built once, by whichever thread gets here first
+  static const std::vector<uint32_t> table = crc32_table();
+
+  uint32_t c = 0xFFFFFFFFUL;
+  for (size_t i = 0; i < length; ++i) {
+    c = table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+  }
+  return c ^ 0xFFFFFFFFUL;
+}
+
+// FUNCTION: appends a PNG chunk with its length and CRC
+// RUNTIME: O(n) - size of the chunk data
+void put_chunk(std::vector<uint8_t>& out, const char* type,
+               const std::vector<uint8_t>& data) {
+  put_u32(out, data.size());
+  size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data.begin(), data.end());
+  put_u32(out, crc32(&out[start], out.size() - start));
+}
+
+// FUNCTION: encodes palette indices as an 8 bit paletted PNG,
+// using uncompressed (stored) deflate blocks
+// RUNTIME: O(n^2) - every row AND column of the image
+void encode_png(const std::vector<uint8_t>& indices, int width, int height,
+                std::vector<uint8_t>& out) {
+  static const uint8_t signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+  out.assign(signature, signature + 8);
+
+  std::vector<uint8_t> header;
+  put_u32(header, width);
+  put_u32(header, height);
+  header.push_back(8); // bit depth
+  header.push_back(3); // colour type: paletted
+  header.push_back(0); // compression
+  header.push_back(0); // filter
+  header.push_back(0); // no interlace
+  put_chunk(out, "IHDR", header);
+
+  std::vector<uint8_t> palette(COLOURS * 3);
+  for (int i = 0; i < COLOURS; ++i) {
+    rgb565_to_rgb(colour_of(i), &palette[3 * i]);
+  }
+  put_chunk(out, "PLTE", palette);
+
+  // every scanline starts with filter type 0 (none)
+  std::vector<uint8_t> raw;
+  raw.reserve((size_t) (width + 1) * height);
+  for (int y = 0; y < height; ++y) {
+    raw.push_back(0);
+    raw.insert(raw.end(), indices.begin() + (size_t) y * width,
+	       indices.begin() + (size_t) (y + 1) * width);
+  }
+
+  // zlib stream made of stored blocks of at most 65535 bytes
+  std::vector<uint8_t> zlib;
+  zlib.push_back(0x78);
+  zlib.push_back(0x01);
+  uint32_t a = 1, b = 0;
+  for (size_t pos = 0; pos < raw.size();) {
+    size_t length = std::min<size_t>(65535, raw.size() - pos);
+    zlib.push_back(pos + length == raw.size() ? 1 : 0); // final block?
+    zlib.push_back(length & 0xFF);
+    zlib.push_back(length >> 8);
+    zlib.push_back(~length & 0xFF);
+    zlib.push_back((~length >> 8) & 0xFF);
+    for (size_t i = pos; i < pos + length; ++i) {
+      a = (a + raw[i]) % 65521;
+      b = (b + a) % 65521;
+    }
+    zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + length);
+    pos += length;
+  }
+  put_u32(zlib, (b << 16) | a); // adler-32
+  put_chunk(out, "IDAT", zlib);
+
+  put_chunk(out, "IEND", std::vector<uint8_t>());
+}
+
+// FUNCTION: encodes palette indices as a binary (P6) PPM
+// RUNTIME: O(n^2) - every row AND column of the image
+void encode_ppm(const std::vector<uint8_t>& indices, int width, int height,
+                std::vector<uint8_t>& out) {
+  char header[32];
+  int length = snprintf(header, sizeof(header), "P6\n%d %d\n255\n",
+			width, height);
+  out.assign(header, header + length);
+
+  uint8_t palette[COLOURS][3];
+  for (int i = 0; i < COLOURS; ++i) {
+    rgb565_to_rgb(colour_of(i), palette[i]);
+  }
+  out.reserve(out.size() + indices.size() * 3);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    out.insert(out.end(), palette[indices[i]], palette[indices[i]] + 3);
+  }
+}
+
+// FUNCTION: converts one dump and writes the image next to its siblings
+// in the output directory
+// RETURNS: true on success, false (with a message) on failure
+// RUNTIME: O(n^2) - see decode and encode_png/encode_ppm
+bool render_file(const Options& options, const std::string& name) {
+  std::string in_path = options.input_dir + "/" + name;
+  int fd = open(in_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "%s: cannot open\n", in_path.c_str());
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size != PixelCanvas::BYTES) {
+    fprintf(stderr, "%s: not a %d byte dump\n", in_path.c_str(),
+	    (int) PixelCanvas::BYTES);
+    close(fd);
+    return false;
+  }
+  void* map = mmap(NULL, PixelCanvas::BYTES, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "%s: cannot map\n", in_path.c_str());
+    return false;
+  }
+
+  std::vector<uint8_t> indices, image;
+  int width = PixelCanvas::WIDTH * options.scale;
+  int height = PixelCanvas::HEIGHT * options.scale;
+  decode(static_cast<const uint8_t*>(map), options.scale, indices);
+  munmap(map, PixelCanvas::BYTES);
+
+  if (options.png) {
+    encode_png(indices, width, height, image);
+  } else {
+    encode_ppm(indices, width, height, image);
+  }
+
+  // keep the whole input name, so that every input has its own output
+  // (a.raw -> a.raw.png) and threads never write the same file
+  std::string out_path = options.output_dir + "/" + name +
+    (options.png ? ".png" : ".ppm");
+  FILE* out = fopen(out_path.c_str(), "wb");
+  if (!out) {
+    fprintf(stderr, "%s: cannot create\n", out_path.c_str());
+    return false;
+  }
+  bool written = fwrite(&image[0], 1, image.size(), out) == image.size();
+  written = (fclose(out) == 0) && written;
+  if (!written) {
+    fprintf(stderr, "%s: write failed\n", out_path.c_str());
+  }
+  return written;
+}
+
+// FUNCTION: parses the command line
+// RETURNS: true if the options are valid
+// RUNTIME: O(n) - number of arguments
+bool parse_options(int argc, char** argv, Options& options) {
+  options.threads = std::max(1u, std::thread::hardware_concurrency());
+  options.scale = 1;
+  options.png = true;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "j:s:f:")) != -1) {
+    if (opt == 'j') {
+      options.threads = atoi(optarg);
+      if (options.threads < 1) return false;
+    } else if (opt == 's') {
+      options.scale = atoi(optarg);
+      if (options.scale != 1 && options.scale != 2 &&
+	  options.scale != 4 && options.scale != 8) return false;
+    } else if (opt == 'f') {
+      if (strcmp(optarg, "png") == 0) {
+	options.png = true;
+      } else if (strcmp(optarg, "ppm") == 0) {
+	options.png = false;
+      } else {
+	return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  if (argc - optind != 2) return false;
+  options.input_dir = argv[optind];
+  options.output_dir = argv[optind + 1];
+  return true;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  // every regular file in the input directory is one task
+  std::vector<std::string> names;
+  DIR* dir = opendir(options.input_dir.c_str());
+  if (!dir) {
+    fprintf(stderr, "%s: cannot open directory\n", options.input_dir.c_str());
+    return 1;
+  }
+  for (struct dirent* entry; (entry = readdir(dir)) != NULL;) {
+    std::string path = options.input_dir + "/" + entry->d_name;
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+
+  // each worker takes the next unclaimed file until none are left;
+  // files are independent, so the output does not depend on the
+  // number of threads
+  std::atomic<size_t> next(0);
+  std::atomic<int> failures(0);
+  std::vector<std::thread> pool;
+  std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+  int threads = std::min<size_t>(options.threads, std::max<size_t>(1, names.size()));
+  for (int t = 0; t < threads; ++t) {
+    pool.push_back(std::thread([&]() {
+	  for (size_t i; (i = next++) < names.size();) {
+	    if (!render_file(options, names[i])) ++failures;
+	  }
+	}));
+  }
+  for (size_t t = 0; t < pool.size(); ++t) {
+    pool[t].join();
+  }
+
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - begin).count();
+  fprintf(stderr, "%zu files, %d failed, %d threads, %.1f files/s\n",
+	  names.size(), failures.load(), threads,
+	  seconds > 0 ? names.size() / seconds : 0.0);
+  return failures == 0 ? 0 : 1;
+}
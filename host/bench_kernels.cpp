@@ -0,0 +1,64 @@
+// Project: Pixel Paint - host benchmark of the pixel kernels
+// Runs run_benchmarks() from benchmark.cpp against functions.cpp,
+// with the Arduino, lcd and EEPROM headers replaced by host/stubs
+
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_ST7735.h>
+#include <SPI.h>
+#include <SD.h>
+#include <EEPROM.h>
+#include "functions.h"
+
+SerialStub Serial;
+EEPROMStub EEPROM;
+
+// the globals that pixel_paint.cpp and autosave.cpp define on the board
+Adafruit_ST7735 tft = Adafruit_ST7735(TFT_CS, TFT_DC, TFT_RST);
+const int WIDTH = 128;
+const int HEIGHT = 160;
+const int JOYSTICK_VERT = 0;
+const int JOYSTICK_HORIZ = 1;
+const int JOYSTICK_BUTTON = 9;
+const int SIZE_DIAL = 2;
+const int SIZE_LED[3] = {2,3,4};
+
+int cursor_y = 0;
+int cursor_x = 0;
+int prev_cursor_y = 0;
+int prev_cursor_x = 0;
+int initial_joystick_y = 512;
+int initial_joystick_x = 512;
+
+int cursor_size = 8;
+int current_colour = BLUE;
+char current_shape = 'r';
+char mode = 'p';
+int cursor_border = 0;
+int pencil_colour = BLUE;
+char pencil_shape = 'r';
+int start = 0;
+int icon_click = 0;
+
+Sd2Card card;
+PixelCanvas all_pixels;
+uint8_t changed_rows[(PixelCanvas::HEIGHT + 7)/8];
+const int MAX_DIRTY_RECTS = 4;
+const unsigned long FRAME_MS = 90;
+DirtyRect dirty_rects[MAX_DIRTY_RECTS];
+int dirty_count = 0;
+unsigned long frame_start = 0;
+int canvas_changed = 0;
+
+// no SD card on the host
+int restore_pending = 0;
+void cancel_restore() {}
+void mark_erased(int, int, int, int) {}
+void remap_restore(const uint8_t[4]) {}
+
+extern int bench_failures;
+
+int main() {
+  run_benchmarks();
+  return bench_failures == 0 ? 0 : 1;
+}
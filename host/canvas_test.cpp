@@ -0,0 +1,123 @@
+// Project: Pixel Paint - host test of the Canvas template
+// Checks get, set, fill_span and drawn_mask at 1, 2 and 4 bits per
+// pixel against a plain one-byte-per-pixel model of the canvas
+
+#include <cstdio>
+#include <vector>
+#include "canvas.h"
+
+int failures = 0;
+
+// FUNCTION: reports a failed check
+// RUNTIME: O(1)
+void fail(const char* canvas, const char* what, int x, int y) {
+  if (failures < 20) {
+    printf("%s: %s wrong at (%d, %d)\n", canvas, what, x, y);
+  }
+  ++failures;
+}
+
+// FUNCTION: xorshift generator, so every run checks the same pixels
+// RETURNS: next pseudo-random 32 bit value
+// RUNTIME: O(1)
+uint32_t next_random() {
+  static uint32_t state = 2463534242UL;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+// FUNCTION: compares every pixel of a canvas with the model, both
+// through get() and by unpacking the bytes in the documented layout
+// RUNTIME: O(n^2) - all rows AND columns
+template <class C>
+void check_pixels(const char* name, const C& canvas,
+		  const std::vector<uint8_t>& model) {
+  for (int y = 0; y < C::HEIGHT; ++y) {
+    for (int x = 0; x < C::WIDTH; ++x) {
+      uint8_t want = model[y * C::WIDTH + x];
+      if (canvas.get(x, y) != want) {
+	fail(name, "get", x, y);
+      }
+      // leftmost pixel of each uint8_t in the most significant bits
+      int s = 8 - C::BITS * (x % C::PIXELS_PER_BYTE + 1);
+      uint8_t packed = canvas.bytes[x / C::PIXELS_PER_BYTE][y];
+      if (((packed >> s) & C::MASK) != want) {
+	fail(name, "layout", x, y);
+      }
+    }
+  }
+}
+
+// FUNCTION: runs every check on one canvas geometry and colour depth
+// RUNTIME: O(n^2) - dominated by the full comparisons with the model
+template <int W, int H, int BPP>
+void test_canvas(const char* name) {
+  typedef Canvas<W, H, BPP> C;
+  static C canvas;
+  std::vector<uint8_t> model(W * H, 0);
+
+  canvas.clear();
+  check_pixels(name, canvas, model);
+
+  // set: random pixels and colours, including overwriting neighbours
+  // in the same uint8_t
+  for (int n = 0; n < 4 * W * H; ++n) {
+    int x = next_random() % W;
+    int y = next_random() % H;
+    uint8_t bits = next_random() & C::MASK;
+    canvas.set(x, y, bits);
+    model[y * W + x] = bits;
+  }
+  check_pixels(name, canvas, model);
+
+  // fill_span: every alignment of both ends, plus empty spans
+  for (int n = 0; n < 2000; ++n) {
+    int x0 = next_random() % (W + 1);
+    int x1 = x0 + next_random() % (W + 1 - x0);
+    if (n % 8 == 0) {
+      x1 = x0;
+    }
+    int y = next_random() % H;
+    uint8_t bits = next_random() & C::MASK;
+    canvas.fill_span(x0, x1, y, bits);
+    for (int x = x0; x < x1; ++x) {
+      model[y * W + x] = bits;
+    }
+  }
+  check_pixels(name, canvas, model);
+
+  // drawn_mask: every packed value, one pixel at a time
+  for (int packed = 0; packed < 256; ++packed) {
+    uint8_t want = 0;
+    for (int x = 0; x < C::PIXELS_PER_BYTE; ++x) {
+      if (C::unpack(packed, x) != 0) {
+	want |= C::MASK << C::shift(x);
+      }
+    }
+    if (C::drawn_mask(packed) != want) {
+      fail(name, "drawn_mask", packed, 0);
+    }
+  }
+
+  canvas.clear();
+  model.assign(W * H, 0);
+  check_pixels(name, canvas, model);
+}
+
+int main() {
+  test_canvas<128, 136, 1>("128x136x1");
+  test_canvas<128, 136, 2>("128x136x2");
+  test_canvas<128, 136, 4>("128x136x4");
+  test_canvas<240, 320, 1>("240x320x1");
+  test_canvas<240, 320, 2>("240x320x2");
+  test_canvas<240, 320, 4>("240x320x4");
+
+  if (failures) {
+    printf("canvas_test: %d failures\n", failures);
+    return 1;
+  }
+  printf("canvas_test: OK\n");
+  return 0;
+}
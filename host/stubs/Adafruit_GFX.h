@@ -0,0 +1 @@
+// host stub, see Adafruit_ST7735.h
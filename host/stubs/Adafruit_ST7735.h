@@ -0,0 +1,38 @@
+#ifndef ADAFRUIT_ST7735_STUB_H
+#define ADAFRUIT_ST7735_STUB_H
+
+// Host stub of the lcd driver: nothing is drawn, but every colour sent
+// pixel by pixel is added to a volatile checksum, so that the compiler
+// cannot drop the code that works the colours out. Host timings of
+// bits_to_colour therefore cover reading and decoding the canvas, but
+// not the SPI transfer.
+
+#include <stdint.h>
+
+#define ST7735_BLACK 0x0000
+#define ST7735_BLUE 0x001F
+#define ST7735_RED 0xF800
+#define ST7735_GREEN 0x07E0
+#define ST7735_CYAN 0x07FF
+#define ST7735_MAGENTA 0xF81F
+#define ST7735_YELLOW 0xFFE0
+#define ST7735_WHITE 0xFFFF
+
+class Adafruit_ST7735 {
+ public:
+  Adafruit_ST7735(int, int, int) : checksum(0) {}
+  void drawPixel(int, int, uint16_t colour) { checksum += colour; }
+  void drawLine(int, int, int, int, uint16_t) {}
+  void drawRect(int, int, int, int, uint16_t) {}
+  void fillRect(int, int, int, int, uint16_t) {}
+  void fillRoundRect(int, int, int, int, int, uint16_t) {}
+  void fillTriangle(int, int, int, int, int, int, uint16_t) {}
+  void drawCircle(int, int, int, uint16_t) {}
+  void fillCircle(int, int, int, uint16_t) {}
+  void setAddrWindow(int, int, int, int) {}
+  void pushColor(uint16_t colour) { checksum += colour; }
+
+  volatile uint32_t checksum; // sum of the colours sent
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef ARDUINO_STUB_H
+#define ARDUINO_STUB_H
+
+// Just enough of the Arduino core to build the pixel kernels on the host
+// (see host/bench_kernels.cpp). Pins read as HIGH and do nothing.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define HEX 16
+
+inline int digitalRead(int) { return HIGH; }
+inline void digitalWrite(int, int) {}
+inline void pinMode(int, int) {}
+inline int analogRead(int) { return 512; }
+
+inline unsigned long micros() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000UL + now.tv_nsec / 1000;
+}
+inline unsigned long millis() { return micros() / 1000; }
+
+template <class T> T min(T a, T b) { return a < b ? a : b; }
+template <class T> T max(T a, T b) { return a > b ? a : b; }
+
+// prints to stdout
+struct SerialStub {
+  void print(const char* s) { fputs(s, stdout); }
+  void print(long n) { printf("%ld", n); }
+  void print(unsigned long n, int base = 10) {
+    printf(base == HEX ? "%lX" : "%lu", n);
+  }
+  void print(int n) { print((long) n); }
+  void print(unsigned int n) { print((unsigned long) n); }
+  template <class T> void println(T value) { print(value); println(); }
+  template <class T> void println(T value, int base) {
+    print(value, base);
+    println();
+  }
+  void println() { putchar('\n'); }
+};
+extern SerialStub Serial;
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef EEPROM_STUB_H
+#define EEPROM_STUB_H
+
+// Host stub of the EEPROM, kept in the file bench_baseline.bin in the
+// current directory so that the benchmark baseline survives between runs.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+class EEPROMStub {
+ public:
+  EEPROMStub() : loaded(false) {}
+
+  uint8_t read(int address) {
+    load();
+    return bytes[address];
+  }
+
+  void write(int address, uint8_t value) {
+    load();
+    bytes[address] = value;
+    FILE* file = fopen("bench_baseline.bin", "wb");
+    if (file) {
+      fwrite(bytes, 1, sizeof(bytes), file);
+      fclose(file);
+    }
+  }
+
+ private:
+  void load() {
+    if (loaded) return;
+    loaded = true;
+    // unwritten EEPROM reads as 0xFF
+    memset(bytes, 0xFF, sizeof(bytes));
+    FILE* file = fopen("bench_baseline.bin", "rb");
+    if (file) {
+      fread(bytes, 1, sizeof(bytes), file);
+      fclose(file);
+    }
+  }
+
+  bool loaded;
+  uint8_t bytes[4096]; // EEPROM size of the Mega 2560
+};
+extern EEPROMStub EEPROM;
+
+#endif
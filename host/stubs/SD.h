@@ -0,0 +1,7 @@
+#ifndef SD_STUB_H
+#define SD_STUB_H
+
+// host stub: only the type named in functions.h
+struct Sd2Card {};
+
+#endif
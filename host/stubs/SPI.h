@@ -0,0 +1 @@
+// host stub: nothing from SPI is used by the kernels
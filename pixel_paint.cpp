@@ -24,6 +24,9 @@ const int JOYSTICK_BUTTON = 9;  // Digital input pin 9 for the button
 const int SIZE_DIAL = 2; // Analog input A2
 const int SIZE_LED[3] = {2,3,4}; // LED outputs
 
+// holding the joystick down on a colour this long swaps colours
+const unsigned long HOLD_MS = 1000;
+
 int cursor_y; // current y position of cursor (topmost pixels of cursor)
 int cursor_x; // current x position of cursor (leftmost pixels of cursor)
 int prev_cursor_y = 0; // declares variable to be used in loop
@@ -43,12 +46,18 @@ char pencil_shape = 'r';
 int start = 1;
 int icon_click = 0;
 
+// startup times printed over Serial: after the first pass of loop()
+// and after the first input from the joystick or size dial is handled
+int first_loop = 1;
+int first_input = 1;
+unsigned long last_input = 0; // when the joystick or dial was last used
+
 Sd2Card card;
 
 /**
-   2D array containing colours of every pixel in the drawing region
+   Colours of every pixel in the drawing region (see canvas.h)
 
-   - each element of array contains data from 4 pixels...
+   - each uint8_t contains data from 4 pixels...
    - there are 4 possible colours :
    WHITE = 0b00, BLACK = 0b01, RED = 0b10, BLUE = 0b11
    - So, each colour can be represented by 2 bits
@@ -59,36 +68,56 @@ Sd2Card card;
    - (128 pixels wide)/(4 pixels/uint8_t) = 32 uint8_t elements to
    contain all pixel data
    in a horizontal row
-   - 136 uint32_t elements to index all horizontal rows
+   - 136 uint8_t elements to index all horizontal rows
+   - other bits per pixel can be chosen with CANVAS_BPP
 */
-uint8_t all_pixels[32][136];
+PixelCanvas all_pixels;
+
+/**
+   Rows of the drawing region that have changed since they were last
+   drawn, used to repaint only those rows after a palette remap
+
+   - bit (j % 8) of changed_rows[j/8] is set when row j has changed
+   - 136 rows / 8 bits per uint8_t = 17 elements
+*/
+uint8_t changed_rows[(PixelCanvas::HEIGHT + 7)/8];
+
+/**
+   Stamps made while drawing are only stored in all_pixels; the regions
+   they cover are collected here and drawn once per frame
+
+   - overlapping or touching regions are merged, so a pixel covered by
+   several stamps in one frame is only sent to the lcd once
+   - a frame lasts FRAME_MS, about 3 stamps at the drawing speed
+*/
+const int MAX_DIRTY_RECTS = 4;
+const unsigned long FRAME_MS = 90;
+DirtyRect dirty_rects[MAX_DIRTY_RECTS];
+int dirty_count = 0;
+unsigned long frame_start = 0;
 
 void setup() {
   Serial.begin(9600);
   tft.initR(INITR_BLACKTAB); // initialize a ST7735R chip, red tab
+  // run the lcd at the same full SPI speed the SD card uses later
+  SPI.setClockDivider(SPI_CLOCK_DIV2);
   pinMode(JOYSTICK_BUTTON, INPUT);
   digitalWrite(JOYSTICK_BUTTON, HIGH);
 
+#ifdef BENCHMARK
+  // time the pixel kernels before the canvas is set up;
+  // the screen is cleared again below
+  run_benchmarks();
+#endif
+
   // configure LED Pins to be the outputs
   for (int i = 0; i < 3; ++i) {
     pinMode(SIZE_LED[i], OUTPUT);
     digitalWrite(SIZE_LED[i], HIGH);
   }
 
-  // Checking to see if SD is initialized and can be read
-  Serial.print("Initializing SD card...");
-  if (!SD.begin(SD_CS)) {
-    Serial.println("failed!");
-    return;
-  }
-  Serial.println("OK!");
-  if (!card.init(SPI_HALF_SPEED, SD_CS)) {
-    Serial.println("Raw SD Initialization has failed");
-    while (1) {};  // Just wait, stuff exploded.
-  }
-
-  // clear screen to white
-  tft.fillScreen(ST7735_WHITE);
+  // clear drawing region to white; draw_background covers the rest
+  tft.fillRect(0, 0, WIDTH, PixelCanvas::HEIGHT, ST7735_WHITE);
 
   // grabs resting position of joystick for calibration
   initial_joystick_y = analogRead(JOYSTICK_VERT); // range from 0-1023
@@ -97,11 +126,17 @@ void setup() {
   initialize_colour_array();
   draw_background();
 
-  cursor_x = WIDTH/2 - cursor_size/2;
-  cursor_y = 68 - cursor_size/2;
+  // start in the middle of the drawing region
+  cursor_x = PixelCanvas::WIDTH/2 - cursor_size/2;
+  cursor_y = PixelCanvas::HEIGHT/2 - cursor_size/2;
   draw_cursor(cursor_x, cursor_y, cursor_size, current_shape, current_colour);
     
   start = 0;
+
+  // the SD card and the saved drawing are brought up from loop() once
+  // the joystick is left alone (see autosave.cpp), so that the cursor
+  // can be used right away
+  last_input = millis();
 }
 
 void loop() {
@@ -114,8 +149,13 @@ void loop() {
   int size = map(point, 0, 1023,4,12);
   point_led(size);
 
+  int used = 0; // set when the joystick or dial is acted on
+
   // if size changes, redraw
   if (size_selection(size)) {
+    // the first pass only picks up where the dial was left
+    used = !first_loop;
+    flush_dirty();
     bits_to_colour(cursor_x,cursor_y, 12);
     draw_background();
     cursor_border = 1;
@@ -146,15 +186,26 @@ void loop() {
   // prevents cursor form moving past the bounds of the lcd screen
   bounds();
 
+  // the joystick is in use when it is pushed past the calibration
+  // margin or pressed down
+  if (abs(joystick_y - initial_joystick_y) > 10 ||
+      abs(joystick_x - initial_joystick_x) > 10 ||
+      digitalRead(JOYSTICK_BUTTON) == LOW) {
+    used = 1;
+  }
+
   // when the joystick is not pressed down, pencil acts as a cursor
   // only make changes if the cursor has moved (except when clicking in icons)
   if(digitalRead(JOYSTICK_BUTTON) == HIGH) {
+    // draw the rest of the stroke before the cursor goes over it
+    flush_dirty();
+
     if ((cursor_x != prev_cursor_x) || (cursor_y != prev_cursor_y) 
 	|| icon_click == 1) {
 	
       // Erase the previous cursor by redrawing over the cursor with
       // the background colour
-      if (prev_cursor_y < 136) { // in drawing region
+      if (prev_cursor_y < PixelCanvas::HEIGHT) { // in drawing region
 	icon_click = 0;
 	// redraw what was "underneath" cursor
 	bits_to_colour(prev_cursor_x, prev_cursor_y, cursor_size);
@@ -178,22 +229,33 @@ void loop() {
 
   // when the joystick is pressed down pencil acts as a drawing tool
   if (digitalRead(JOYSTICK_BUTTON) == LOW) {
-    if (cursor_y < 136) {
+    if (cursor_y < PixelCanvas::HEIGHT) {
       icon_click = 0;
-      draw_cursor(cursor_x, cursor_y, 
-		  cursor_size, current_shape,
-		  current_colour);
+      // the stamp is drawn from all_pixels with the rest of the frame
       store_colour(cursor_x, cursor_y, cursor_size, current_colour);
+      mark_dirty(cursor_x, cursor_y, cursor_size);
+      if (millis() - frame_start >= FRAME_MS) {
+	flush_dirty();
+      }
       delay(30); // delay so that cursor does not move too quickly
 
     } else {
+      flush_dirty();
       icon_click = 1;
       // prevents user from holding down and moving the joystick
       // as there is no use for that in the icon region
+      unsigned long press_start = millis();
       while(digitalRead(JOYSTICK_BUTTON) == LOW) {}
+      int held = millis() - press_start >= HOLD_MS;
       if(cursor_x < 24) { // selecting colour for pencil
 	if(mode == 'p') { // when in eraser mode you cannot change colour
-	  change_colour();
+	  if(held) { // swap the colours in the drawing as well
+	    swap_colours();
+	  } else {
+	    change_colour();
+	  }
+	} else if(held) { // erase that colour from the whole drawing
+	  replace_colour(swatch_colour(), current_colour);
 	}
       } else if(cursor_x > 24 && cursor_x < 51) { // selecting pencil mode
 	pencil();
@@ -210,5 +272,24 @@ void loop() {
   // updates the previous cursor position to current cursor
   prev_cursor_y = cursor_y;
   prev_cursor_x = cursor_x;
+
+  if (first_loop) {
+    first_loop = 0;
+    Serial.print("Ready for input after ");
+    Serial.print(millis());
+    Serial.println(" ms");
+  }
+  if (used) {
+    last_input = millis();
+    if (first_input) {
+      first_input = 0;
+      Serial.print("First input handled after ");
+      Serial.print(last_input);
+      Serial.println(" ms");
+    }
+  }
+
+  // start the SD card, restore a band of the saved drawing, or autosave
+  storage_step();
 }
 